@@ -13,9 +13,9 @@ MainComponent::MainComponent()
     setSize (800, 600);
 
     // Initialize WebGPU on background thread
-    std::thread ([this]()
+    std::thread ([this, size = getRenderTargetSize()]()
                  {
-        bool success = webgpuGraphics->initialize(getWidth(), getHeight());
+        bool success = webgpuGraphics->initialize(size.x, size.y);
         juce::MessageManager::callAsync([this, success]() {
             if (success) {
                 statusLabel.setText("WebGPU initialized successfully!", juce::dontSendNotification);
@@ -51,8 +51,23 @@ void MainComponent::paint (juce::Graphics& g)
 
     if (isInitialized && ! renderedImage.isNull())
     {
+        // The next frame is rendered for the scale of the context that is actually painted to
+        paintScale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        const auto physicalArea = getPhysicalRenderArea (paintScale);
+
         // Draw the WebGPU rendered image
-        g.drawImage (renderedImage, getLocalBounds().toFloat());
+        if (renderedImage.getWidth() == physicalArea.getWidth() && renderedImage.getHeight() == physicalArea.getHeight())
+        {
+            // Drawn in physical pixels at a whole pixel position, so it's a blit without resampling
+            juce::Graphics::ScopedSaveState state (g);
+            g.addTransform (juce::AffineTransform::scale (1.0f / paintScale));
+            g.drawImageAt (renderedImage, physicalArea.getX(), physicalArea.getY());
+        }
+        else
+        {
+            // The size or scale has changed since this frame was rendered
+            g.drawImage (renderedImage, getRenderArea().toFloat());
+        }
     }
     else
     {
@@ -70,11 +85,35 @@ void MainComponent::resized()
     auto statusArea = bounds.removeFromTop (30);
     statusLabel.setBounds (statusArea);
 
-    // Resize WebGPU graphics if initialized
-    if (isInitialized && webgpuGraphics)
-    {
-        webgpuGraphics->resize (getWidth(), getHeight() - 30); // Account for status label
-    }
+    // The render target is resized by the next frame rendered, see renderGraphics
+}
+
+juce::Rectangle<int> MainComponent::getRenderArea() const
+{
+    return getLocalBounds().withTrimmedTop (statusLabel.getHeight());
+}
+
+float MainComponent::getRenderScale() const
+{
+    // Until the first paint, the scale of the context isn't known
+    return paintScale > 0.0f ? paintScale : juce::Component::getApproximateScaleFactorForComponent (this);
+}
+
+juce::Rectangle<int> MainComponent::getPhysicalRenderArea (float scale) const
+{
+    // Snapped inwards to whole physical pixels, as with fractional scales the edges can fall between them
+    const auto area = getRenderArea().toFloat() * scale;
+    const int left = (int) std::ceil (area.getX());
+    const int top = (int) std::ceil (area.getY());
+    const int right = std::max (left + 1, (int) std::floor (area.getRight()));
+    const int bottom = std::max (top + 1, (int) std::floor (area.getBottom()));
+    return juce::Rectangle<int>::leftTopRightBottom (left, top, right, bottom);
+}
+
+juce::Point<int> MainComponent::getRenderTargetSize() const
+{
+    const auto area = getPhysicalRenderArea (getRenderScale());
+    return { area.getWidth(), area.getHeight() };
 }
 
 void MainComponent::timerCallback()
@@ -89,8 +128,11 @@ void MainComponent::timerCallback()
 void MainComponent::renderGraphics()
 {
     // Render frame on background thread to avoid blocking UI
-    std::thread ([this]()
+    // The render target is sized to match the destination's physical pixels,
+    // which also follows changes of the display scale
+    std::thread ([this, size = getRenderTargetSize()]()
                  {
+        webgpuGraphics->resize(size.x, size.y);
         juce::Image newImage = webgpuGraphics->renderFrameToImage();
         
         juce::MessageManager::callAsync([this, newImage]() {
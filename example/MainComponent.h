@@ -16,12 +16,19 @@ private:
     void timerCallback() override;
     void renderGraphics();
 
+    // Where the rendered image goes, in logical and in physical pixels, and its size in physical pixels
+    juce::Rectangle<int> getRenderArea() const;
+    float getRenderScale() const;
+    juce::Rectangle<int> getPhysicalRenderArea (float scale) const;
+    juce::Point<int> getRenderTargetSize() const;
+
     std::unique_ptr<WebGPUGraphics> webgpuGraphics;
 
     juce::Label statusLabel;
     juce::Image renderedImage;
 
     bool isInitialized = false;
+    float paintScale = 0.0f; // Physical pixels per logical pixel of the last paint
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
@@ -1,5 +1,6 @@
 #include "WebGPUGraphics.h"
 #include "WebGPUJuceUtils.h"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstring>
@@ -46,18 +47,26 @@ void WebGPUGraphics::resize (int width, int height)
     if (! initialized || (width == textureWidth && height == textureHeight))
         return;
 
-    textureWidth = width;
-    textureHeight = height;
-
     // Recreate textures with new size
-    createTexture (width, height);
+    if (createTexture (width, height))
+    {
+        textureWidth = width;
+        textureHeight = height;
+    }
+    else
+    {
+        // Nothing is rendered until a later resize succeeds
+        juce::Logger::writeToLog ("Failed to create WebGPU texture of size " + juce::String (width) + "x" + juce::String (height));
+        textureWidth = 0;
+        textureHeight = 0;
+    }
 }
 
 void WebGPUGraphics::renderFrame()
 {
     std::lock_guard<std::mutex> lock (textureMutex);
 
-    if (! initialized.load() || shutdownRequested.load())
+    if (! initialized.load() || shutdownRequested.load() || ! texture.view)
         return;
 
     scene.render (context, texture);
@@ -71,15 +80,38 @@ juce::Image WebGPUGraphics::renderFrameToImage()
     renderFrame();
 
     std::lock_guard<std::mutex> lock (textureMutex);
-    if (! initialized.load() || shutdownRequested.load())
+    if (! initialized.load() || shutdownRequested.load() || ! texture.texture)
         return {};
 
-    juce::Image image (juce::Image::ARGB, textureWidth, textureHeight, true);
-    WebGPUJuceUtils::readTextureToImage (context, texture, image);
+    // The pooled image isn't cleared, so it must not be shown when the readback failed
+    juce::Image image = acquireImage();
+    if (! WebGPUJuceUtils::readTextureToImage (context, texture, image))
+        return {};
 
     return image;
 }
 
+juce::Image WebGPUGraphics::acquireImage()
+{
+    // Images of an old size won't be used again
+    imagePool.erase (std::remove_if (imagePool.begin(),
+                                     imagePool.end(),
+                                     [this] (const juce::Image& image)
+                                     { return image.getWidth() != textureWidth || image.getHeight() != textureHeight; }),
+                     imagePool.end());
+
+    // The UI is done with an image when the pool holds the only reference to it
+    for (const juce::Image& image : imagePool)
+        if (image.getReferenceCount() == 1)
+            return image;
+
+    // No need to clear the image, as the texture readback overwrites all of it
+    juce::Image image (juce::Image::ARGB, textureWidth, textureHeight, false);
+    if (imagePool.size() < maxPooledImages)
+        imagePool.push_back (image);
+    return image;
+}
+
 void WebGPUGraphics::shutdown()
 {
     shutdownRequested.store (true);
@@ -5,6 +5,7 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <webgpu/webgpu-raii.hpp>
 
 #include "WebGPUExampleScene.h"
@@ -39,6 +40,7 @@ public:
 
 private:
     bool createTexture (int width, int height);
+    juce::Image acquireImage();
 
     std::atomic<bool> initialized { false };
     std::atomic<bool> shutdownRequested { false };
@@ -50,5 +52,9 @@ private:
     WebGPUExampleScene scene;
     WebGPUTexture texture;
 
+    // Images handed out by renderFrameToImage, reused once nobody else references them
+    std::vector<juce::Image> imagePool;
+    static constexpr size_t maxPooledImages = 4;
+
     static constexpr uint32_t bytesPerPixel = 4; // RGBA8
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <webgpu/webgpu-raii.hpp>
+
+// Runs pipeline compilations one after another on a single background thread.
+// WebGPUContext owns one, shared by all of its WebGPUAsyncPipeline objects.
+class WebGPUPipelineCompiler
+{
+public:
+    ~WebGPUPipelineCompiler();
+
+    void enqueue (std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::thread worker; // Started by the first job
+};
+
+// A render pipeline that compiles in the background so rendering never waits for it.
+// Nothing should be drawn with it until the first compilation is ready.
+// Compiling again (for example after editing the WGSL source) keeps drawing the previous pipeline
+// until the new one is ready.
+class WebGPUAsyncPipeline
+{
+public:
+    using CreatePipeline = std::function<wgpu::raii::RenderPipeline()>;
+
+    ~WebGPUAsyncPipeline();
+
+    // Queues the pipeline creation and returns immediately.
+    // A request that hasn't started yet is skipped when a newer one is made.
+    void compile (WebGPUPipelineCompiler&, CreatePipeline);
+
+    // Call from the render thread at a frame boundary, to swap in a newly compiled pipeline.
+    void update();
+
+    // The pipeline to draw with, or nullptr when none has finished compiling yet.
+    WGPURenderPipeline get();
+
+private:
+    // Shared with queued jobs, which may outlive this object
+    struct State
+    {
+        std::mutex mutex;
+        std::mutex compiling; // Held while a job of this pipeline runs
+        uint64_t generation = 0;
+        bool cancelled = false;
+        wgpu::raii::RenderPipeline compiled; // Ready, but not swapped in yet
+    };
+
+    std::shared_ptr<State> state = std::make_shared<State>();
+    wgpu::raii::RenderPipeline current;
+};
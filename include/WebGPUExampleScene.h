@@ -1,10 +1,10 @@
 #pragma once
 
+#include "WebGPUAsyncPipeline.h"
+#include "WebGPUUtils.h"
+#include <memory>
 #include <webgpu/webgpu-raii.hpp>
 
-struct WebGPUContext;
-struct WebGPUTexture;
-
 // An example scene that draws a colored triangle.
 // Can be used for validating that the webgpu setup works.
 
@@ -15,12 +15,16 @@ public:
     void render (WebGPUContext& context, WebGPUTexture& renderTarget);
     void shutdown();
 
+    // Recompiles the pipeline with new vertex shader source in the background.
+    // The current pipeline keeps drawing until the new one is ready.
+    bool reloadVertexShader (WebGPUContext& context, const char* wgslSource);
+
 private:
     bool createVertexBuffer (WebGPUContext& context);
-    bool createPipeline (WebGPUContext& context);
+    void compilePipeline (WebGPUContext& context, std::shared_ptr<wgpu::raii::ShaderModule> vertexShader);
+    wgpu::raii::RenderPipeline createPipeline (WebGPUContext& context, WGPUShaderModule vertexModule);
 
-    wgpu::raii::ShaderModule vertexShader;
     wgpu::raii::ShaderModule fragmentShader;
-    wgpu::raii::Buffer vertexBuffer;
-    wgpu::raii::RenderPipeline renderPipeline;
+    WebGPUBuffer vertexBuffer;
+    WebGPUAsyncPipeline renderPipeline;
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "WebGPUUtils.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <webgpu/webgpu-raii.hpp>
+
+// Streams rendered frames to a file, for offline renders and capture.
+// Frames are converted on the GPU and read back asynchronously, and a writer thread writes them to disk,
+// so adding a frame only waits when all readback buffers are still in use.
+class WebGPUFrameExporter
+{
+public:
+    enum class Format
+    {
+        // YUV 4:2:0 (BT.709, limited range) in a Y4M stream.
+        // Converted by a compute shader, which makes the readback about 2.7x smaller than RGBA.
+        // The texture needs the TextureBinding usage and a non-sRGB format, as sampling an sRGB
+        // texture gives linear values. Width must be a multiple of 8 and height a multiple of 2.
+        Y4M,
+        // Raw RGBA8 frames, one after another. The texture needs the CopySrc usage.
+        RawRGBA,
+    };
+
+    struct Options
+    {
+        std::string path;
+        Format format = Format::Y4M;
+        int framesPerSecond = 60;
+        // Bounds the memory used for frames that are read back or waiting to be written
+        size_t maxFramesInFlight = 3;
+    };
+
+    ~WebGPUFrameExporter();
+
+    // The texture's size and format must stay the same for all frames.
+    // Fails when the texture lacks the usage or format the export format needs.
+    bool start (WebGPUContext&, const WebGPUTexture&, const Options&);
+    bool addFrame (WebGPUTexture&);
+    // Waits for all added frames to be written and closes the file.
+    void finish();
+
+private:
+    struct Slot
+    {
+        WebGPUBuffer staging;
+        bool mapped = false;
+        bool failed = false;
+    };
+
+    bool createConverter();
+    size_t acquireSlot();
+    void encodeConversion (wgpu::raii::CommandEncoder&, WebGPUTexture&, Slot&);
+    void encodeCopy (wgpu::raii::CommandEncoder&, WebGPUTexture&, Slot&);
+    void runWriter();
+    void writeFrame (const uint8_t* data);
+
+    WebGPUContext* context = nullptr;
+    Options options;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    WGPUTextureFormat sourceFormat = WGPUTextureFormat_Undefined;
+    WGPUTextureUsage requiredUsage = WGPUTextureUsage_None;
+    uint32_t sourceBytesPerRow = 0;
+    uint64_t stagingSize = 0;
+
+    wgpu::raii::ShaderModule converterShader;
+    wgpu::raii::ComputePipeline converterPipeline;
+    WebGPUBuffer converted;
+
+    std::ofstream file;
+    std::vector<uint8_t> rowScratch;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::vector<Slot> slots;
+    std::deque<size_t> freeSlots;
+    std::deque<size_t> submitted; // In submission order
+    bool stopping = false;
+    bool writeFailed = false;
+    std::thread writer;
+};
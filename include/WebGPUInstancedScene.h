@@ -0,0 +1,58 @@
+#pragma once
+
+#include "WebGPUAsyncPipeline.h"
+#include "WebGPUUtils.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <webgpu/webgpu-raii.hpp>
+
+// A scene that draws many simple shapes, with one instanced draw call per kind of shape.
+// Suitable for plots and particle views with large numbers of elements.
+
+class WebGPUInstancedScene
+{
+public:
+    enum class Shape : uint32_t
+    {
+        Quad,
+        Triangle,
+        Circle,
+        count
+    };
+
+    struct Instance
+    {
+        float position[2]; // Centre, in clip space
+        float size[2]; // Half extents, in clip space
+        float rotation; // Radians
+        float color[4];
+        Shape shape;
+    };
+
+    bool initialize (WebGPUContext& context);
+    void render (WebGPUContext& context, WebGPUTexture& renderTarget);
+
+    // Replaces the instances to draw. Can be called every frame, from the render thread.
+    // Fails when there are more instances than the device's buffer size limit allows.
+    bool setInstances (WebGPUContext& context, const Instance* instances, size_t count);
+
+private:
+    bool reserveInstances (WebGPUContext& context, size_t count);
+    wgpu::raii::RenderPipeline createPipeline (WebGPUContext& context);
+
+    wgpu::raii::ShaderModule vertexShader;
+    wgpu::raii::ShaderModule fragmentShader;
+    WebGPUBuffer instanceBuffer;
+    size_t instanceCapacity = 0;
+    size_t instanceCount = 0;
+    std::vector<Instance> sortedInstances; // Instances grouped by shape, if they weren't already
+
+    struct ShapeRange
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+    ShapeRange shapeRanges[(size_t) Shape::count];
+    WebGPUAsyncPipeline renderPipeline;
+};
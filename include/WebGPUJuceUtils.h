@@ -7,9 +7,26 @@ namespace juce
 class Image;
 }
 
+// How float textures are brought into the 8-bit range of a JUCE Image
+struct WebGPUImageDecodeOptions
+{
+    enum class ToneMapping
+    {
+        Clamp,
+        Reinhard, // c / (1 + c), which keeps highlights above 1 distinguishable
+    };
+
+    ToneMapping toneMapping = ToneMapping::Clamp;
+    float exposure = 1.0f;
+    // Float textures usually hold linear values, which need sRGB encoding for display
+    bool linearToSrgb = false;
+};
+
 struct WebGPUJuceUtils
 {
-    // Read back RGBA texture data into a JUCE Image.
+    // Read back texture data into an ARGB JUCE Image.
     // Image and texture sizes must match!
-    static void readTextureToImage (WebGPUContext&, WebGPUTexture&, juce::Image&);
+    // Single channel formats are shown as grayscale, and missing channels are 0 (or opaque for alpha).
+    // Returns false for formats that can't be decoded, such as compressed ones.
+    static bool readTextureToImage (WebGPUContext&, WebGPUTexture&, juce::Image&, const WebGPUImageDecodeOptions& = {});
 };
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Keeps count of the GPU memory held by buffers and textures created through WebGPUContext,
+// and enforces an optional budget on new allocations.
+class WebGPUMemoryTracker
+{
+public:
+    enum class Category
+    {
+        Texture,
+        Buffer,
+        Staging, // Buffers that can be mapped for reading or writing
+        count
+    };
+
+    struct Budget
+    {
+        // When an allocation would exceed the soft limit, the evictors are asked to free memory.
+        // Zero means no limit.
+        uint64_t softLimit = 0;
+        // Allocations past the hard limit are rejected, or only warned about if rejectOverHardLimit is false.
+        // The evictors are asked to free memory first, also when there is no soft limit.
+        uint64_t hardLimit = 0;
+        bool rejectOverHardLimit = true;
+    };
+
+    struct Record
+    {
+        Category category;
+        uint64_t size;
+        uint64_t usage;
+        std::string label;
+        // Set when the size is a guess, for texture formats whose layout isn't known
+        bool sizeIsEstimate;
+    };
+
+    struct Totals
+    {
+        uint64_t live = 0;
+        uint64_t peak = 0;
+        size_t count = 0;
+    };
+
+    // Marks a tracked allocation as live for as long as it exists.
+    // Keep it next to the resource it was created for.
+    class Allocation
+    {
+    public:
+        Allocation() = default;
+        Allocation (Allocation&&) noexcept;
+        Allocation& operator= (Allocation&&) noexcept;
+        ~Allocation();
+
+        explicit operator bool() const { return tracker != nullptr; }
+
+    private:
+        friend class WebGPUMemoryTracker;
+        Allocation (WebGPUMemoryTracker* owner, uint64_t allocationId) : tracker (owner), id (allocationId) {}
+        void release();
+
+        WebGPUMemoryTracker* tracker = nullptr;
+        uint64_t id = 0;
+    };
+
+    // An evictor frees pooled resources when asked to and returns how many bytes it released.
+    using Evictor = std::function<uint64_t (uint64_t bytesWanted)>;
+
+    // Returns an empty Allocation when the budget does not allow it.
+    Allocation allocate (Category, uint64_t size, uint64_t usage, std::string label, bool sizeIsEstimate = false);
+
+    void setBudget (const Budget&);
+    Budget getBudget() const;
+
+    int addEvictor (Evictor);
+    void removeEvictor (int evictorId);
+
+    Totals getTotals (Category) const;
+    Totals getTotals() const;
+    std::vector<Record> getLiveAllocations() const;
+
+private:
+    void release (uint64_t id);
+    uint64_t evict (uint64_t bytesWanted);
+
+    mutable std::mutex mutex;
+    Budget budget;
+    std::map<uint64_t, Record> records;
+    uint64_t nextId = 1;
+    Totals totals[(size_t) Category::count];
+    Totals overall;
+    std::map<int, Evictor> evictors;
+    int nextEvictorId = 1;
+};
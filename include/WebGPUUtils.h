@@ -1,7 +1,20 @@
 #pragma once
 
+#include "WebGPUAsyncPipeline.h"
+#include "WebGPUMemoryTracker.h"
+#include <mutex>
+#include <vector>
 #include <webgpu/webgpu-raii.hpp>
 
+// A buffer together with its entry in the context's memory tracker
+struct WebGPUBuffer
+{
+    wgpu::raii::Buffer buffer;
+    WebGPUMemoryTracker::Allocation allocation;
+    uint64_t size = 0;
+    WGPUBufferUsage usage = WGPUBufferUsage_None;
+};
+
 // To use WebGPU you first need to initialize the context.
 // It includes objects you will always need.
 struct WebGPUContext
@@ -10,21 +23,73 @@ struct WebGPUContext
     wgpu::raii::Device device;
     wgpu::raii::Queue queue;
 
+    // Accounts for buffers and textures created via createBuffer and WebGPUTexture::init
+    WebGPUMemoryTracker memory;
+
+    // Compiles WebGPUAsyncPipeline objects in the background
+    WebGPUPipelineCompiler pipelineCompiler;
+
     bool init();
     wgpu::raii::ShaderModule loadWgslShader (const char* source, const char* name = nullptr);
+
+    // Returns an empty buffer if creation failed or the memory budget does not allow it
+    WebGPUBuffer createBuffer (const WGPUBufferDescriptor&);
+
+    // Like createBuffer, but reuses a recycled buffer of the same size and usage when there is one.
+    // Recycled buffers with the same usage but a different size are released.
+    // Recycled buffers are idle, so they are the first to be evicted when over the memory budget.
+    WebGPUBuffer acquireBuffer (const WGPUBufferDescriptor&);
+    // Hands back a buffer from acquireBuffer that is no longer used. It must not be mapped.
+    void recycleBuffer (WebGPUBuffer);
+
+private:
+    uint64_t evictRecycledBuffers (uint64_t bytesWanted);
+
+    std::mutex recycledBuffersMutex;
+    std::vector<WebGPUBuffer> recycledBuffers;
+    static constexpr size_t maxRecycledBuffers = 8;
+};
+
+// How the texels of a texture format are laid out in memory.
+// Compressed formats are described in blocks of texels.
+struct WebGPUTextureFormatInfo
+{
+    enum class ChannelType
+    {
+        Unorm8,
+        Float16,
+        Float32,
+        Integer, // Not decoded to images
+        Compressed,
+    };
+
+    WGPUTextureFormat format;
+    uint32_t bytesPerBlock;
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    ChannelType channelType;
+    uint32_t channelCount;
+    // Index of the red, green, blue and alpha channels within a texel, or -1 when absent
+    int channelIndex[4];
+
+    // Returns nullptr for formats that aren't in the table
+    static const WebGPUTextureFormatInfo* find (WGPUTextureFormat);
 };
 
 struct WebGPUTexture
 {
     wgpu::raii::Texture texture;
     wgpu::raii::TextureView view;
+    WebGPUMemoryTracker::Allocation allocation;
 
     // The descriptor contains texture size and format
     WGPUTextureDescriptor descriptor;
 
     bool init (WebGPUContext&, const WGPUTextureDescriptor&);
-    wgpu::raii::Buffer read (WebGPUContext&);
+    // Both return empty results for formats without a WebGPUTextureFormatInfo
+    WebGPUBuffer read (WebGPUContext&);
     int bytesPerRow() const;
+    uint32_t rowCount() const;
 };
 
 struct WebGPUPassThroughFragmentShader
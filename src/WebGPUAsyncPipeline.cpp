@@ -0,0 +1,91 @@
+#include "WebGPUAsyncPipeline.h"
+
+// Note that wgpu-native doesn't implement wgpuDeviceCreateRenderPipelineAsync,
+// so the synchronous creation is done on a worker thread instead.
+
+WebGPUPipelineCompiler::~WebGPUPipelineCompiler()
+{
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void WebGPUPipelineCompiler::enqueue (std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        jobs.push_back (std::move (job));
+        if (! worker.joinable())
+            worker = std::thread ([this] { run(); });
+    }
+    wakeUp.notify_one();
+}
+
+void WebGPUPipelineCompiler::run()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+    while (true)
+    {
+        wakeUp.wait (lock, [this] { return stopping || ! jobs.empty(); });
+        if (stopping)
+            return;
+
+        std::function<void()> job = std::move (jobs.front());
+        jobs.pop_front();
+
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+WebGPUAsyncPipeline::~WebGPUAsyncPipeline()
+{
+    // Wait for a compilation in progress, as it may use the object that requested it
+    std::lock_guard<std::mutex> compiling (state->compiling);
+    std::lock_guard<std::mutex> lock (state->mutex);
+    state->cancelled = true;
+}
+
+void WebGPUAsyncPipeline::compile (WebGPUPipelineCompiler& compiler, CreatePipeline create)
+{
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock (state->mutex);
+        generation = ++state->generation;
+    }
+
+    compiler.enqueue ([job = state, generation, create = std::move (create)]
+                      {
+                          std::lock_guard<std::mutex> compiling (job->compiling);
+                          {
+                              std::lock_guard<std::mutex> lock (job->mutex);
+                              if (job->cancelled || generation != job->generation)
+                                  return;
+                          }
+
+                          wgpu::raii::RenderPipeline pipeline = create();
+
+                          std::lock_guard<std::mutex> lock (job->mutex);
+                          if (pipeline && generation == job->generation)
+                              job->compiled = std::move (pipeline);
+                      });
+}
+
+void WebGPUAsyncPipeline::update()
+{
+    std::lock_guard<std::mutex> lock (state->mutex);
+    if (state->compiled)
+        current = std::move (state->compiled);
+}
+
+WGPURenderPipeline WebGPUAsyncPipeline::get()
+{
+    if (! current)
+        return nullptr;
+    return *current;
+}
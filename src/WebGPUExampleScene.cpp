@@ -25,16 +25,30 @@ const char* vertexShaderSource = R"(
 
 bool WebGPUExampleScene::initialize (WebGPUContext& context)
 {
-    vertexShader = context.loadWgslShader (vertexShaderSource);
+    auto vertexShader = std::make_shared<wgpu::raii::ShaderModule> (context.loadWgslShader (vertexShaderSource));
     fragmentShader = context.loadWgslShader (WebGPUPassThroughFragmentShader::wgslSource);
-    if (! fragmentShader || ! vertexShader)
+    if (! fragmentShader || ! *vertexShader)
         return false;
 
-    return createVertexBuffer (context) && createPipeline (context);
+    // Frames are only cleared until the pipeline is ready
+    compilePipeline (context, vertexShader);
+    return createVertexBuffer (context);
+}
+
+bool WebGPUExampleScene::reloadVertexShader (WebGPUContext& context, const char* wgslSource)
+{
+    auto vertexShader = std::make_shared<wgpu::raii::ShaderModule> (context.loadWgslShader (wgslSource));
+    if (! *vertexShader)
+        return false;
+
+    compilePipeline (context, vertexShader);
+    return true;
 }
 
 void WebGPUExampleScene::render (WebGPUContext& context, WebGPUTexture& texture)
 {
+    renderPipeline.update();
+
     wgpu::raii::CommandEncoder encoder = context.device->createCommandEncoder();
 
     {
@@ -49,9 +63,12 @@ void WebGPUExampleScene::render (WebGPUContext& context, WebGPUTexture& texture)
             .colorAttachments = &colorAttachment,
         });
 
-        renderPass->setPipeline (*renderPipeline);
-        renderPass->setVertexBuffer (0, *vertexBuffer, 0, WGPU_WHOLE_SIZE);
-        renderPass->draw (3, 1, 0, 0); // Draw 3 vertices (triangle)
+        if (WGPURenderPipeline pipeline = renderPipeline.get())
+        {
+            renderPass->setPipeline (pipeline);
+            renderPass->setVertexBuffer (0, *vertexBuffer.buffer, 0, WGPU_WHOLE_SIZE);
+            renderPass->draw (3, 1, 0, 0); // Draw 3 vertices (triangle)
+        }
         renderPass->end();
     }
 
@@ -73,19 +90,29 @@ bool WebGPUExampleScene::createVertexBuffer (WebGPUContext& context)
         { { 0.8f, -0.8f }, { 0.0f, 0.0f, 1.0f } }, // Bottom right - blue
     };
 
-    vertexBuffer = context.device->createBuffer (WGPUBufferDescriptor {
+    vertexBuffer = context.createBuffer (WGPUBufferDescriptor {
+        .label = wgpu::StringView ("Example scene vertices"),
         .usage = wgpu::BufferUsage::Vertex,
         .size = sizeof (vertices),
         .mappedAtCreation = true,
     });
 
-    std::memcpy (vertexBuffer->getMappedRange (0, sizeof (vertices)), vertices, sizeof (vertices));
-    vertexBuffer->unmap();
+    if (! vertexBuffer.buffer)
+        return false;
+
+    std::memcpy (vertexBuffer.buffer->getMappedRange (0, sizeof (vertices)), vertices, sizeof (vertices));
+    vertexBuffer.buffer->unmap();
 
-    return vertexBuffer;
+    return true;
 }
 
-bool WebGPUExampleScene::createPipeline (WebGPUContext& context)
+void WebGPUExampleScene::compilePipeline (WebGPUContext& context, std::shared_ptr<wgpu::raii::ShaderModule> vertexShader)
+{
+    renderPipeline.compile (context.pipelineCompiler, [this, &context, vertexShader]
+                            { return createPipeline (context, **vertexShader); });
+}
+
+wgpu::raii::RenderPipeline WebGPUExampleScene::createPipeline (WebGPUContext& context, WGPUShaderModule vertexModule)
 {
     WGPUVertexAttribute attributes[2] {
         {
@@ -120,10 +147,10 @@ bool WebGPUExampleScene::createPipeline (WebGPUContext& context)
         .targets = &colorTarget,
     };
 
-    renderPipeline = context.device->createRenderPipeline (WGPURenderPipelineDescriptor {
+    return wgpu::raii::RenderPipeline (context.device->createRenderPipeline (WGPURenderPipelineDescriptor {
         .layout = nullptr, // Auto layout
         .vertex = {
-            .module = *vertexShader,
+            .module = vertexModule,
             .entryPoint = wgpu::StringView ("vs_main"),
             .bufferCount = 1,
             .buffers = &vertexBufferLayout,
@@ -140,7 +167,5 @@ bool WebGPUExampleScene::createPipeline (WebGPUContext& context)
             .alphaToCoverageEnabled = false,
         },
         .fragment = &fragmentState,
-    });
-
-    return renderPipeline;
+    }));
 }
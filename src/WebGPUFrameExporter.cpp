@@ -0,0 +1,377 @@
+#include "WebGPUFrameExporter.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+
+// Converts the texture to planar YUV 4:2:0 with BT.709 limited range coefficients.
+// Each invocation converts 4 horizontally adjacent pixels, packed as bytes in a u32,
+// and those at even rows and multiples of 8 pixels also write 4 chroma samples per plane.
+const char* yuvShaderSource = R"(
+    @group(0) @binding(0) var source: texture_2d<f32>;
+    @group(0) @binding(1) var<storage, read_write> output: array<u32>;
+
+    const LUMA_WEIGHTS = vec3<f32>(0.2126, 0.7152, 0.0722);
+
+    fn luma(c: vec3<f32>) -> f32 {
+        return 16.0 + 219.0 * dot(c, LUMA_WEIGHTS);
+    }
+
+    fn chroma(c: vec3<f32>) -> vec2<f32> {
+        let y = dot(c, LUMA_WEIGHTS);
+        return vec2<f32>(128.0 + 224.0 * (c.b - y) / 1.8556, 128.0 + 224.0 * (c.r - y) / 1.5748);
+    }
+
+    fn pack(v: vec4<f32>) -> u32 {
+        let b = vec4<u32>(clamp(round(v), vec4<f32>(0.0), vec4<f32>(255.0)));
+        return b.x | (b.y << 8u) | (b.z << 16u) | (b.w << 24u);
+    }
+
+    fn load(x: u32, y: u32) -> vec3<f32> {
+        return textureLoad(source, vec2<u32>(x, y), 0).rgb;
+    }
+
+    @compute @workgroup_size(8, 8)
+    fn main(@builtin(global_invocation_id) id: vec3<u32>) {
+        let size = textureDimensions(source);
+        let x = id.x * 4u;
+        let y = id.y;
+        if (x >= size.x || y >= size.y) {
+            return;
+        }
+
+        var lumas: vec4<f32>;
+        for (var i = 0u; i < 4u; i++) {
+            lumas[i] = luma(load(x + i, y));
+        }
+        output[(y * size.x + x) / 4u] = pack(lumas);
+
+        if (y % 2u != 0u || x % 8u != 0u) {
+            return;
+        }
+
+        var cb: vec4<f32>;
+        var cr: vec4<f32>;
+        for (var i = 0u; i < 4u; i++) {
+            let px = x + 2u * i;
+            let average = 0.25 * (load(px, y) + load(px + 1u, y) + load(px, y + 1u) + load(px + 1u, y + 1u));
+            let c = chroma(average);
+            cb[i] = c.x;
+            cr[i] = c.y;
+        }
+        let lumaWords = size.x * size.y / 4u;
+        let chromaWords = lumaWords / 4u;
+        let chromaIndex = ((y / 2u) * (size.x / 2u) + x / 2u) / 4u;
+        output[lumaWords + chromaIndex] = pack(cb);
+        output[lumaWords + chromaWords + chromaIndex] = pack(cr);
+    }
+)";
+
+const uint32_t WORKGROUP_SIZE = 8;
+
+} // namespace
+
+WebGPUFrameExporter::~WebGPUFrameExporter()
+{
+    finish();
+}
+
+bool WebGPUFrameExporter::start (WebGPUContext& newContext, const WebGPUTexture& texture, const Options& newOptions)
+{
+    finish();
+
+    context = &newContext;
+    options = newOptions;
+    width = texture.descriptor.size.width;
+    height = texture.descriptor.size.height;
+    sourceFormat = texture.descriptor.format;
+    sourceBytesPerRow = (uint32_t) texture.bytesPerRow();
+
+    if (sourceFormat != WGPUTextureFormat_RGBA8Unorm && sourceFormat != WGPUTextureFormat_RGBA8UnormSrgb
+        && sourceFormat != WGPUTextureFormat_BGRA8Unorm && sourceFormat != WGPUTextureFormat_BGRA8UnormSrgb)
+        return false;
+
+    // Recording a frame from a texture without these usages fails validation, which wgpu-native treats as fatal
+    requiredUsage = options.format == Format::Y4M ? WGPUTextureUsage_TextureBinding : WGPUTextureUsage_CopySrc;
+    if ((texture.descriptor.usage & requiredUsage) != requiredUsage)
+        return false;
+
+    if (options.format == Format::Y4M)
+    {
+        // The conversion needs gamma encoded values, which sRGB textures don't give when sampled
+        if (sourceFormat == WGPUTextureFormat_RGBA8UnormSrgb || sourceFormat == WGPUTextureFormat_BGRA8UnormSrgb)
+            return false;
+        if (width % 8 != 0 || height % 2 != 0 || ! createConverter())
+            return false;
+        stagingSize = (uint64_t) width * height * 3 / 2;
+    }
+    else
+    {
+        stagingSize = (uint64_t) sourceBytesPerRow * height;
+        rowScratch.resize ((size_t) width * 4);
+    }
+
+    slots.clear();
+    slots.resize (std::max<size_t> (options.maxFramesInFlight, 1));
+    freeSlots.clear();
+    submitted.clear();
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        slots[i].staging = context->createBuffer (WGPUBufferDescriptor {
+            .label = wgpu::StringView ("Frame export readback"),
+            .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead,
+            .size = stagingSize,
+            .mappedAtCreation = false,
+        });
+        if (! slots[i].staging.buffer)
+            return false;
+        freeSlots.push_back (i);
+    }
+
+    file.open (options.path, std::ios::binary | std::ios::trunc);
+    if (! file)
+        return false;
+
+    if (options.format == Format::Y4M)
+        file << "YUV4MPEG2 W" << width << " H" << height << " F" << options.framesPerSecond
+             << ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+
+    stopping = false;
+    writeFailed = false;
+    writer = std::thread ([this] { runWriter(); });
+    return true;
+}
+
+bool WebGPUFrameExporter::createConverter()
+{
+    converterShader = context->loadWgslShader (yuvShaderSource, "RGB to YUV");
+    if (! converterShader)
+        return false;
+
+    converterPipeline = context->device->createComputePipeline (WGPUComputePipelineDescriptor {
+        .layout = nullptr, // Auto layout
+        .compute = {
+            .module = *converterShader,
+            .entryPoint = wgpu::StringView ("main"),
+        },
+    });
+    if (! converterPipeline)
+        return false;
+
+    converted = context->createBuffer (WGPUBufferDescriptor {
+        .label = wgpu::StringView ("Frame export YUV"),
+        .usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc,
+        .size = (uint64_t) width * height * 3 / 2,
+        .mappedAtCreation = false,
+    });
+    return converted.buffer;
+}
+
+bool WebGPUFrameExporter::addFrame (WebGPUTexture& texture)
+{
+    if (! writer.joinable())
+        return false;
+
+    if (texture.descriptor.size.width != width || texture.descriptor.size.height != height || texture.descriptor.format != sourceFormat
+        || (texture.descriptor.usage & requiredUsage) != requiredUsage)
+        return false;
+
+    const size_t slotIndex = acquireSlot();
+    Slot& slot = slots[slotIndex];
+
+    {
+        wgpu::raii::CommandEncoder encoder = context->device->createCommandEncoder();
+        if (options.format == Format::Y4M)
+            encodeConversion (encoder, texture, slot);
+        else
+            encodeCopy (encoder, texture, slot);
+        context->queue->submit (1, &*wgpu::raii::CommandBuffer (encoder->finish()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        submitted.push_back (slotIndex);
+    }
+
+    slot.staging.buffer->mapAsync (
+        WGPUMapMode_Read, 0, stagingSize, WGPUBufferMapCallbackInfo {
+                                              .mode = WGPUCallbackMode_AllowProcessEvents,
+                                              .callback = [] (WGPUMapAsyncStatus status, WGPUStringView, void* userdata1, void* userdata2)
+                                              {
+                                                  auto* exporter = reinterpret_cast<WebGPUFrameExporter*> (userdata1);
+                                                  auto& mappedSlot = exporter->slots[reinterpret_cast<size_t> (userdata2)];
+                                                  {
+                                                      std::lock_guard<std::mutex> lock (exporter->mutex);
+                                                      mappedSlot.mapped = true;
+                                                      mappedSlot.failed = status != WGPUMapAsyncStatus_Success;
+                                                  }
+                                                  exporter->wakeUp.notify_all();
+                                              },
+                                              .userdata1 = this,
+                                              .userdata2 = reinterpret_cast<void*> (slotIndex),
+                                          });
+
+    context->instance->processEvents();
+
+    std::lock_guard<std::mutex> lock (mutex);
+    return ! writeFailed;
+}
+
+size_t WebGPUFrameExporter::acquireSlot()
+{
+    // Waiting here is what bounds the memory use when the GPU or the disk can't keep up
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            if (! freeSlots.empty())
+            {
+                const size_t slotIndex = freeSlots.front();
+                freeSlots.pop_front();
+                return slotIndex;
+            }
+        }
+        context->instance->processEvents();
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+}
+
+void WebGPUFrameExporter::encodeConversion (wgpu::raii::CommandEncoder& encoder, WebGPUTexture& texture, Slot& slot)
+{
+    const WGPUBindGroupEntry entries[2] {
+        {
+            .binding = 0,
+            .textureView = *texture.view,
+        },
+        {
+            .binding = 1,
+            .buffer = *converted.buffer,
+            .offset = 0,
+            .size = stagingSize,
+        },
+    };
+    wgpu::raii::BindGroup bindGroup = context->device->createBindGroup (WGPUBindGroupDescriptor {
+        .layout = *wgpu::raii::BindGroupLayout (converterPipeline->getBindGroupLayout (0)),
+        .entryCount = 2,
+        .entries = entries,
+    });
+
+    {
+        wgpu::raii::ComputePassEncoder pass = encoder->beginComputePass (WGPUComputePassDescriptor {});
+        pass->setPipeline (*converterPipeline);
+        pass->setBindGroup (0, *bindGroup, 0, nullptr);
+        pass->dispatchWorkgroups ((width / 4 + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+        pass->end();
+    }
+
+    encoder->copyBufferToBuffer (*converted.buffer, 0, *slot.staging.buffer, 0, stagingSize);
+}
+
+void WebGPUFrameExporter::encodeCopy (wgpu::raii::CommandEncoder& encoder, WebGPUTexture& texture, Slot& slot)
+{
+    encoder->copyTextureToBuffer (
+        WGPUTexelCopyTextureInfo {
+            .texture = *texture.texture,
+            .mipLevel = 0,
+            .origin = { 0, 0, 0 },
+            .aspect = WGPUTextureAspect_All,
+        },
+        WGPUTexelCopyBufferInfo {
+            .layout = {
+                .offset = 0,
+                .bytesPerRow = sourceBytesPerRow,
+                .rowsPerImage = height,
+            },
+            .buffer = *slot.staging.buffer,
+        },
+        WGPUExtent3D {
+            .width = width,
+            .height = height,
+            .depthOrArrayLayers = 1,
+        });
+}
+
+void WebGPUFrameExporter::runWriter()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+    while (true)
+    {
+        wakeUp.wait (lock, [this]
+                     { return (stopping && submitted.empty()) || (! submitted.empty() && slots[submitted.front()].mapped); });
+        if (submitted.empty())
+            return;
+
+        const size_t slotIndex = submitted.front();
+        submitted.pop_front();
+        Slot& slot = slots[slotIndex];
+        const bool failed = slot.failed;
+
+        lock.unlock();
+        if (! failed)
+        {
+            writeFrame ((const uint8_t*) slot.staging.buffer->getConstMappedRange (0, stagingSize));
+            slot.staging.buffer->unmap();
+        }
+        lock.lock();
+
+        slot.mapped = false;
+        writeFailed = writeFailed || failed || ! file;
+        freeSlots.push_back (slotIndex);
+    }
+}
+
+void WebGPUFrameExporter::writeFrame (const uint8_t* data)
+{
+    if (options.format == Format::Y4M)
+    {
+        file << "FRAME\n";
+        file.write ((const char*) data, (std::streamsize) stagingSize);
+        return;
+    }
+
+    const bool isBGRA = sourceFormat == WGPUTextureFormat_BGRA8Unorm || sourceFormat == WGPUTextureFormat_BGRA8UnormSrgb;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = data + (size_t) y * sourceBytesPerRow;
+        if (isBGRA)
+        {
+            for (size_t i = 0; i < rowScratch.size(); i += 4)
+            {
+                rowScratch[i + 0] = row[i + 2];
+                rowScratch[i + 1] = row[i + 1];
+                rowScratch[i + 2] = row[i + 0];
+                rowScratch[i + 3] = row[i + 3];
+            }
+            row = rowScratch.data();
+        }
+        file.write ((const char*) row, (std::streamsize) width * 4);
+    }
+}
+
+void WebGPUFrameExporter::finish()
+{
+    if (! writer.joinable())
+        return;
+
+    // Keep processing events until every submitted frame has been mapped and written
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            if (freeSlots.size() == slots.size())
+                break;
+        }
+        context->instance->processEvents();
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    writer.join();
+    file.close();
+}
@@ -0,0 +1,267 @@
+#include "WebGPUInstancedScene.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+namespace
+{
+
+const uint32_t CIRCLE_SEGMENTS = 16;
+
+// Indexed by shape
+const uint32_t VERTICES_PER_SHAPE[] { 6, 3, 3 * CIRCLE_SEGMENTS };
+static_assert (std::size (VERTICES_PER_SHAPE) == (size_t) WebGPUInstancedScene::Shape::count);
+
+size_t getShapeIndex (const WebGPUInstancedScene::Instance& instance)
+{
+    // Unknown shapes are drawn as circles, like in the shader
+    return std::min ((size_t) instance.shape, (size_t) WebGPUInstancedScene::Shape::Circle);
+}
+
+static_assert (sizeof (WebGPUInstancedScene::Instance) == 10 * sizeof (float));
+
+const char* vertexShaderSource = R"(
+    struct VertexOutput {
+        @builtin(position) position: vec4<f32>,
+        @location(0) color: vec4<f32>,
+    }
+
+    const CIRCLE_SEGMENTS: u32 = 16u;
+    const PI: f32 = 3.14159265;
+
+    fn circlePoint(index: u32) -> vec2<f32> {
+        let angle = f32(index) * 2.0 * PI / f32(CIRCLE_SEGMENTS);
+        return vec2<f32>(cos(angle), sin(angle));
+    }
+
+    // The vertex position in the shape's unit space
+    fn shapeVertex(shape: u32, vertex: u32) -> vec2<f32> {
+        switch shape {
+            case 0u: { // Quad
+                var corners = array<vec2<f32>, 6>(
+                    vec2<f32>(-1.0, -1.0), vec2<f32>(1.0, -1.0), vec2<f32>(1.0, 1.0),
+                    vec2<f32>(-1.0, -1.0), vec2<f32>(1.0, 1.0), vec2<f32>(-1.0, 1.0));
+                return corners[vertex];
+            }
+            case 1u: { // Triangle
+                var corners = array<vec2<f32>, 3>(
+                    vec2<f32>(0.0, 1.0), vec2<f32>(-1.0, -1.0), vec2<f32>(1.0, -1.0));
+                return corners[vertex];
+            }
+            default: { // Circle, as a fan of triangles around the centre
+                let corner = vertex % 3u;
+                if (corner == 0u) {
+                    return vec2<f32>(0.0, 0.0);
+                }
+                return circlePoint(vertex / 3u + corner - 1u);
+            }
+        }
+    }
+
+    @vertex
+    fn vs_main(
+        @builtin(vertex_index) vertex: u32,
+        @location(0) center: vec2<f32>,
+        @location(1) size: vec2<f32>,
+        @location(2) rotation: f32,
+        @location(3) color: vec4<f32>,
+        @location(4) shape: u32,
+    ) -> VertexOutput {
+        let local = shapeVertex(shape, vertex) * size;
+        let c = cos(rotation);
+        let s = sin(rotation);
+        var output: VertexOutput;
+        output.position = vec4<f32>(center + vec2<f32>(local.x * c - local.y * s, local.x * s + local.y * c), 0.0, 1.0);
+        output.color = color;
+        return output;
+    }
+)";
+
+} // namespace
+
+bool WebGPUInstancedScene::initialize (WebGPUContext& context)
+{
+    vertexShader = context.loadWgslShader (vertexShaderSource);
+    fragmentShader = context.loadWgslShader (WebGPUPassThroughFragmentShader::wgslSource);
+    if (! vertexShader || ! fragmentShader)
+        return false;
+
+    // Frames are only cleared until the pipeline is ready
+    renderPipeline.compile (context.pipelineCompiler, [this, &context]
+                            { return createPipeline (context); });
+    return true;
+}
+
+void WebGPUInstancedScene::render (WebGPUContext& context, WebGPUTexture& texture)
+{
+    renderPipeline.update();
+
+    wgpu::raii::CommandEncoder encoder = context.device->createCommandEncoder();
+
+    {
+        WGPURenderPassColorAttachment colorAttachment {
+            .view = *texture.view,
+            .loadOp = WGPULoadOp_Clear,
+            .storeOp = WGPUStoreOp_Store,
+            .clearValue = { 0.2f, 0.2f, 0.2f, 1.0f }, // Dark gray background
+        };
+        wgpu::raii::RenderPassEncoder renderPass = encoder->beginRenderPass (WGPURenderPassDescriptor {
+            .colorAttachmentCount = 1,
+            .colorAttachments = &colorAttachment,
+        });
+
+        WGPURenderPipeline pipeline = renderPipeline.get();
+        if (pipeline != nullptr && instanceCount > 0)
+        {
+            renderPass->setPipeline (pipeline);
+            renderPass->setVertexBuffer (0, *instanceBuffer.buffer, 0, instanceCount * sizeof (Instance));
+            for (size_t shape = 0; shape < (size_t) Shape::count; ++shape)
+                if (shapeRanges[shape].count > 0)
+                    renderPass->draw (VERTICES_PER_SHAPE[shape], shapeRanges[shape].count, 0, shapeRanges[shape].first);
+        }
+        renderPass->end();
+    }
+
+    wgpu::raii::CommandBuffer commands = encoder->finish();
+    context.queue->submit (1, &*commands);
+}
+
+bool WebGPUInstancedScene::setInstances (WebGPUContext& context, const Instance* instances, size_t count)
+{
+    if (! reserveInstances (context, count))
+    {
+        instanceCount = 0;
+        return false;
+    }
+
+    // Instances are grouped by shape, so that each shape is drawn with only the vertices it needs
+    ShapeRange ranges[(size_t) Shape::count];
+    for (size_t i = 0; i < count; ++i)
+        ++ranges[getShapeIndex (instances[i])].count;
+    for (size_t shape = 1; shape < (size_t) Shape::count; ++shape)
+        ranges[shape].first = ranges[shape - 1].first + ranges[shape - 1].count;
+
+    const Instance* upload = instances;
+    const auto byShape = [] (const Instance& a, const Instance& b) { return getShapeIndex (a) < getShapeIndex (b); };
+    if (! std::is_sorted (instances, instances + count, byShape))
+    {
+        sortedInstances.resize (count);
+        uint32_t next[(size_t) Shape::count];
+        for (size_t shape = 0; shape < (size_t) Shape::count; ++shape)
+            next[shape] = ranges[shape].first;
+        for (size_t i = 0; i < count; ++i)
+            sortedInstances[next[getShapeIndex (instances[i])]++] = instances[i];
+        upload = sortedInstances.data();
+    }
+
+    if (count > 0)
+        context.queue->writeBuffer (*instanceBuffer.buffer, 0, upload, count * sizeof (Instance));
+    instanceCount = count;
+    std::copy (std::begin (ranges), std::end (ranges), std::begin (shapeRanges));
+    return true;
+}
+
+bool WebGPUInstancedScene::reserveInstances (WebGPUContext& context, size_t count)
+{
+    if (count <= instanceCapacity)
+        return true;
+
+    WGPULimits limits {};
+    if (wgpuDeviceGetLimits (*context.device, &limits) != WGPUStatus_Success)
+        return false;
+    const size_t maxInstances = (size_t) (limits.maxBufferSize / sizeof (Instance));
+    if (count > maxInstances)
+        return false;
+
+    // Grow geometrically so that slowly growing instance counts don't reallocate every frame
+    size_t newCapacity = std::max<size_t> (instanceCapacity, 1024);
+    while (newCapacity < count)
+        newCapacity *= 2;
+    newCapacity = std::min (newCapacity, maxInstances);
+
+    // Release the old buffer first, so that its memory doesn't count against the budget for the new one
+    instanceBuffer = WebGPUBuffer();
+    instanceCapacity = 0;
+    instanceBuffer = context.createBuffer (WGPUBufferDescriptor {
+        .label = wgpu::StringView ("Scene instances"),
+        .usage = wgpu::BufferUsage::Vertex | wgpu::BufferUsage::CopyDst,
+        .size = newCapacity * sizeof (Instance),
+        .mappedAtCreation = false,
+    });
+    instanceCapacity = instanceBuffer.buffer ? newCapacity : 0;
+    return instanceBuffer.buffer;
+}
+
+wgpu::raii::RenderPipeline WebGPUInstancedScene::createPipeline (WebGPUContext& context)
+{
+    WGPUVertexAttribute attributes[5] {
+        {
+            .format = WGPUVertexFormat_Float32x2,
+            .offset = offsetof (Instance, position),
+            .shaderLocation = 0,
+        },
+        {
+            .format = WGPUVertexFormat_Float32x2,
+            .offset = offsetof (Instance, size),
+            .shaderLocation = 1,
+        },
+        {
+            .format = WGPUVertexFormat_Float32,
+            .offset = offsetof (Instance, rotation),
+            .shaderLocation = 2,
+        },
+        {
+            .format = WGPUVertexFormat_Float32x4,
+            .offset = offsetof (Instance, color),
+            .shaderLocation = 3,
+        },
+        {
+            .format = WGPUVertexFormat_Uint32,
+            .offset = offsetof (Instance, shape),
+            .shaderLocation = 4,
+        },
+    };
+
+    WGPUVertexBufferLayout instanceBufferLayout {
+        .stepMode = WGPUVertexStepMode_Instance,
+        .arrayStride = sizeof (Instance),
+        .attributeCount = 5,
+        .attributes = attributes,
+    };
+
+    WGPUColorTargetState colorTarget {
+        .format = WGPUTextureFormat_BGRA8Unorm,
+        .blend = nullptr,
+        .writeMask = WGPUColorWriteMask_All,
+    };
+
+    WGPUFragmentState fragmentState {
+        .module = *fragmentShader,
+        .entryPoint = wgpu::StringView (WebGPUPassThroughFragmentShader::entryPoint),
+        .targetCount = 1,
+        .targets = &colorTarget,
+    };
+
+    return wgpu::raii::RenderPipeline (context.device->createRenderPipeline (WGPURenderPipelineDescriptor {
+        .layout = nullptr, // Auto layout
+        .vertex = {
+            .module = *vertexShader,
+            .entryPoint = wgpu::StringView ("vs_main"),
+            .bufferCount = 1,
+            .buffers = &instanceBufferLayout,
+        },
+        .primitive = {
+            .topology = WGPUPrimitiveTopology_TriangleList,
+            .stripIndexFormat = WGPUIndexFormat_Undefined,
+            .frontFace = WGPUFrontFace_CCW,
+            .cullMode = WGPUCullMode_None,
+        },
+        .multisample = {
+            .count = 1,
+            .mask = UINT32_MAX,
+            .alphaToCoverageEnabled = false,
+        },
+        .fragment = &fragmentState,
+    }));
+}
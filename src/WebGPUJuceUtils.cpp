@@ -1,45 +1,242 @@
 #include "WebGPUJuceUtils.h"
 
 #include "WebGPUUtils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <juce_graphics/juce_graphics.h>
+#include <vector>
 
-void WebGPUJuceUtils::readTextureToImage (WebGPUContext& context, WebGPUTexture& texture, juce::Image& image)
+// MSVC has no F16C macro, but every CPU with AVX2 has F16C
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+    #define JUCE_WEBGPU_F16C 1
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+namespace
+{
+
+float bitsToFloat (uint32_t bits)
+{
+    float value;
+    std::memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+uint32_t floatToBits (float value)
+{
+    uint32_t bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    return bits;
+}
+
+// Both cases are computed and picked with bit masks rather than branches, so that loops over it
+// can be vectorized by the compiler.
+float halfToFloat (uint16_t half)
+{
+    const uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    const uint32_t magnitude = (uint32_t) (half & 0x7fff) << 13;
+    const uint32_t exponent = magnitude & 0x0f800000;
+
+    // Rebias the exponent, and for infinity and NaN extend it to the float's maximum
+    uint32_t bits = magnitude + ((127 - 15) << 23);
+    bits += (uint32_t) (exponent == 0x0f800000) * ((128 - 16) << 23);
+
+    // Subnormal halves are normal floats: the mantissa times 2^-24
+    const uint32_t subnormal = floatToBits ((float) (int32_t) (half & 0x03ff) * 0x1p-24f);
+    const uint32_t subnormalMask = 0u - (uint32_t) (exponent == 0);
+    bits = (subnormal & subnormalMask) | (bits & ~subnormalMask);
+    return bitsToFloat (bits | sign);
+}
+
+// Uses the hardware conversion where the target has one: F16C on x86 (when built with -mf16c, /arch:AVX2
+// or a -march that includes it) and NEON on 64-bit ARM.
+void halvesToFloats (const uint16_t* halves, float* values, size_t count)
+{
+    size_t i = 0;
+#if defined(JUCE_WEBGPU_F16C)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps (values + i, _mm256_cvtph_ps (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (halves + i))));
+#elif defined(__aarch64__)
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32 (values + i, vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (halves + i))));
+#endif
+    for (; i < count; ++i)
+        values[i] = halfToFloat (halves[i]);
+}
+
+const std::array<uint8_t, 4096>& getLinearToSrgbTable()
+{
+    static const auto table = []
+    {
+        std::array<uint8_t, 4096> result;
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            const double linear = (double) i / (double) (result.size() - 1);
+            const double srgb = linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow (linear, 1.0 / 2.4) - 0.055;
+            result[i] = (uint8_t) std::lround (srgb * 255.0);
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Unlike std::clamp, this also maps NaN to 0
+float clampUnit (float value)
+{
+    return value > 0.0f ? std::min (value, 1.0f) : 0.0f;
+}
+
+// Applies exposure and tone mapping, giving values in [0, 1].
+// Each loop is kept to a few selects and arithmetic, as more (such as also scaling the result) stops
+// GCC from vectorizing it. std::max (0.0f, x) also maps NaN to 0, and negative values are clamped
+// before Reinhard, where they would flip sign or divide by zero.
+void toneMap (const float* values, float* mapped, size_t count, const WebGPUImageDecodeOptions& options)
+{
+    const float exposure = options.exposure;
+    if (options.toneMapping == WebGPUImageDecodeOptions::ToneMapping::Reinhard)
+    {
+        for (size_t i = 0; i < count; ++i)
+            mapped[i] = std::max (0.0f, values[i] * exposure);
+        for (size_t i = 0; i < count; ++i)
+            mapped[i] = std::min (1.0f, mapped[i] / (1.0f + mapped[i]));
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            mapped[i] = std::min (1.0f, std::max (0.0f, values[i] * exposure));
+    }
+}
+
+// Maps a texel's channels to red, green, blue and alpha.
+// Single channel formats are replicated to gray, and a missing alpha is opaque.
+template <typename Channel, typename Pixel>
+Pixel getPixel (const Channel* texel, const WebGPUTextureFormatInfo& info, Channel zero, Channel opaque)
+{
+    const bool gray = info.channelCount == 1;
+    const auto channel = [&] (int index) { return index < 0 ? zero : texel[index]; };
+    return {
+        channel (gray ? 0 : info.channelIndex[0]),
+        channel (gray ? 0 : info.channelIndex[1]),
+        channel (gray ? 0 : info.channelIndex[2]),
+        info.channelIndex[3] < 0 ? opaque : texel[info.channelIndex[3]],
+    };
+}
+
+void decodeUnorm8Row (const uint8_t* src, juce::PixelARGB* dst, int width, const WebGPUTextureFormatInfo& info)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        const auto [r, g, b, a] = getPixel<uint8_t, std::array<uint8_t, 4>> (src + x * (int) info.channelCount, info, 0, 255);
+        dst[x].setARGB (a, r, g, b);
+        dst[x].premultiply();
+    }
+}
+
+struct FloatRowScratch
+{
+    std::vector<float> values;
+    std::vector<float> mapped;
+    std::vector<uint8_t> bytes;
+};
+
+// Float rows are decoded in passes over whole rows, with the options chosen once per row rather than
+// per channel: tone mapping all channels, encoding them as bytes, replacing the alpha channel with its
+// clamped linear value, and then mapping the channels to pixels like an 8-bit format.
+void decodeFloatRow (FloatRowScratch& scratch, juce::PixelARGB* dst, int width, const WebGPUTextureFormatInfo& info, const WebGPUImageDecodeOptions& options)
+{
+    const size_t count = scratch.values.size();
+    scratch.mapped.resize (count);
+    scratch.bytes.resize (count);
+    const float* values = scratch.values.data();
+    float* mapped = scratch.mapped.data();
+    uint8_t* bytes = scratch.bytes.data();
+
+    toneMap (values, mapped, count, options);
+
+    if (options.linearToSrgb)
+    {
+        // Looked up with 12 bits of precision
+        const auto& table = getLinearToSrgbTable();
+        for (size_t i = 0; i < count; ++i)
+            bytes[i] = table[(size_t) (int32_t) (mapped[i] * 4095.0f + 0.5f)];
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            bytes[i] = (uint8_t) (int32_t) (mapped[i] * 255.0f + 0.5f);
+    }
+
+    if (const int alpha = info.channelIndex[3]; alpha >= 0)
+        for (size_t i = (size_t) alpha; i < count; i += info.channelCount)
+            bytes[i] = (uint8_t) (clampUnit (values[i]) * 255.0f + 0.5f);
+
+    decodeUnorm8Row (bytes, dst, width, info);
+}
+
+} // namespace
+
+bool WebGPUJuceUtils::readTextureToImage (WebGPUContext& context, WebGPUTexture& texture, juce::Image& image, const WebGPUImageDecodeOptions& options)
 {
     jassert (texture.descriptor.size.width == (uint32_t) image.getWidth());
     jassert (texture.descriptor.size.height == (uint32_t) image.getHeight());
+    jassert (image.getFormat() == juce::Image::ARGB);
 
-    wgpu::raii::Buffer readbackBuffer = texture.read (context);
+    const WebGPUTextureFormatInfo* info = WebGPUTextureFormatInfo::find (texture.descriptor.format);
+    if (info == nullptr || info->channelType == WebGPUTextureFormatInfo::ChannelType::Integer
+        || info->channelType == WebGPUTextureFormatInfo::ChannelType::Compressed)
+        return false;
+
+    WebGPUBuffer readback = texture.read (context);
+    if (! readback.buffer)
+        return false;
+    wgpu::raii::Buffer& readbackBuffer = readback.buffer;
 
-    // Copy pixel data (WebGPU uses RGBA, JUCE uses ARGB)
     const int bytesPerRow = texture.bytesPerRow();
-    const auto src = (uint8_t*) readbackBuffer->getConstMappedRange (0, bytesPerRow * texture.descriptor.size.height);
+    const int width = (int) texture.descriptor.size.width;
+    const int height = (int) texture.descriptor.size.height;
+    const auto src = (const uint8_t*) readbackBuffer->getConstMappedRange (0, (size_t) bytesPerRow * texture.rowCount());
     juce::Image::BitmapData bitmap (image, juce::Image::BitmapData::writeOnly);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wswitch-enum"
+    const size_t valuesPerRow = (size_t) width * info->channelCount;
+    FloatRowScratch scratch;
 
-    switch (texture.descriptor.format)
+    for (int y = 0; y < height; ++y)
     {
-        case WGPUTextureFormat_BGRA8Unorm:
-        case WGPUTextureFormat_BGRA8UnormSrgb:
-            for (int y = 0; y < (int) texture.descriptor.size.height; ++y)
-                std::memcpy (bitmap.getLinePointer (y), src + y * bytesPerRow, (size_t) texture.descriptor.size.width * 4);
-            break;
-        case WGPUTextureFormat_RGBA8Unorm:
-        case WGPUTextureFormat_RGBA8UnormSrgb:
-            for (int y = 0; y < (int) texture.descriptor.size.height; ++y)
-                for (int x = 0; x < (int) texture.descriptor.size.width; ++x)
-                {
-                    const int srcIndex = y * bytesPerRow + x * 4;
-                    bitmap.setPixelColour (x, y, juce::Colour::fromRGBA (src[srcIndex + 0], src[srcIndex + 1], src[srcIndex + 2], src[srcIndex + 3]));
-                }
-            break;
-        default:
-            jassertfalse; // Unsupported format
-            break;
-    }
+        const uint8_t* row = src + y * bytesPerRow;
+        auto* dst = reinterpret_cast<juce::PixelARGB*> (bitmap.getLinePointer (y));
 
-#pragma GCC diagnostic pop
+        switch (info->channelType)
+        {
+            case WebGPUTextureFormatInfo::ChannelType::Unorm8:
+                // JUCE's ARGB pixels are stored as BGRA, so BGRA textures need no conversion
+                if (info->channelCount == 4 && info->channelIndex[0] == 2)
+                    std::memcpy (dst, row, (size_t) width * 4);
+                else
+                    decodeUnorm8Row (row, dst, width, *info);
+                break;
+            case WebGPUTextureFormatInfo::ChannelType::Float16:
+            {
+                scratch.values.resize (valuesPerRow);
+                halvesToFloats (reinterpret_cast<const uint16_t*> (row), scratch.values.data(), valuesPerRow);
+                decodeFloatRow (scratch, dst, width, *info, options);
+                break;
+            }
+            case WebGPUTextureFormatInfo::ChannelType::Float32:
+                scratch.values.resize (valuesPerRow);
+                std::memcpy (scratch.values.data(), row, valuesPerRow * sizeof (float));
+                decodeFloatRow (scratch, dst, width, *info, options);
+                break;
+            case WebGPUTextureFormatInfo::ChannelType::Integer:
+            case WebGPUTextureFormatInfo::ChannelType::Compressed:
+                break;
+        }
+    }
 
     readbackBuffer->unmap();
+    context.recycleBuffer (std::move (readback));
+    return true;
 }
@@ -0,0 +1,158 @@
+#include "WebGPUMemoryTracker.h"
+
+#include <algorithm>
+#include <iostream>
+
+WebGPUMemoryTracker::Allocation::Allocation (Allocation&& other) noexcept
+    : tracker (other.tracker), id (other.id)
+{
+    other.tracker = nullptr;
+}
+
+WebGPUMemoryTracker::Allocation& WebGPUMemoryTracker::Allocation::operator= (Allocation&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        tracker = other.tracker;
+        id = other.id;
+        other.tracker = nullptr;
+    }
+    return *this;
+}
+
+WebGPUMemoryTracker::Allocation::~Allocation()
+{
+    release();
+}
+
+void WebGPUMemoryTracker::Allocation::release()
+{
+    if (tracker != nullptr)
+        tracker->release (id);
+    tracker = nullptr;
+}
+
+WebGPUMemoryTracker::Allocation WebGPUMemoryTracker::allocate (Category category, uint64_t size, uint64_t usage, std::string label, bool sizeIsEstimate)
+{
+    uint64_t overLimit = 0;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        // Evict down to whichever limit is lower, so that pooled resources are freed before anything is rejected
+        uint64_t evictionLimit = budget.softLimit;
+        if (budget.hardLimit != 0 && (evictionLimit == 0 || budget.hardLimit < evictionLimit))
+            evictionLimit = budget.hardLimit;
+        if (evictionLimit != 0 && overall.live + size > evictionLimit)
+            overLimit = overall.live + size - evictionLimit;
+    }
+
+    // Evictors release resources, which calls back into the tracker, so they run without the lock held
+    if (overLimit != 0)
+        evict (overLimit);
+
+    std::lock_guard<std::mutex> lock (mutex);
+
+    if (budget.hardLimit != 0 && overall.live + size > budget.hardLimit)
+    {
+        std::cerr << "WebGPU allocation of " << size << " bytes for '" << label << "' exceeds the hard limit ("
+                  << overall.live << " of " << budget.hardLimit << " bytes in use)"
+                  << (budget.rejectOverHardLimit ? ", rejected" : "") << std::endl;
+        if (budget.rejectOverHardLimit)
+            return {};
+    }
+
+    const uint64_t id = nextId++;
+    records[id] = Record { category, size, usage, std::move (label), sizeIsEstimate };
+
+    for (Totals* t : { &totals[(size_t) category], &overall })
+    {
+        t->live += size;
+        t->peak = std::max (t->peak, t->live);
+        ++t->count;
+    }
+
+    return Allocation (this, id);
+}
+
+void WebGPUMemoryTracker::release (uint64_t id)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+
+    const auto it = records.find (id);
+    if (it == records.end())
+        return;
+
+    for (Totals* t : { &totals[(size_t) it->second.category], &overall })
+    {
+        t->live -= it->second.size;
+        --t->count;
+    }
+    records.erase (it);
+}
+
+uint64_t WebGPUMemoryTracker::evict (uint64_t bytesWanted)
+{
+    std::vector<Evictor> toCall;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        for (const auto& [evictorId, evictor] : evictors)
+            toCall.push_back (evictor);
+    }
+
+    uint64_t freed = 0;
+    for (const Evictor& evictor : toCall)
+    {
+        if (freed >= bytesWanted)
+            break;
+        freed += evictor (bytesWanted - freed);
+    }
+    return freed;
+}
+
+void WebGPUMemoryTracker::setBudget (const Budget& newBudget)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    budget = newBudget;
+}
+
+WebGPUMemoryTracker::Budget WebGPUMemoryTracker::getBudget() const
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    return budget;
+}
+
+int WebGPUMemoryTracker::addEvictor (Evictor evictor)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    const int evictorId = nextEvictorId++;
+    evictors[evictorId] = std::move (evictor);
+    return evictorId;
+}
+
+void WebGPUMemoryTracker::removeEvictor (int evictorId)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    evictors.erase (evictorId);
+}
+
+WebGPUMemoryTracker::Totals WebGPUMemoryTracker::getTotals (Category category) const
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    return totals[(size_t) category];
+}
+
+WebGPUMemoryTracker::Totals WebGPUMemoryTracker::getTotals() const
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    return overall;
+}
+
+std::vector<WebGPUMemoryTracker::Record> WebGPUMemoryTracker::getLiveAllocations() const
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    std::vector<Record> result;
+    result.reserve (records.size());
+    for (const auto& [id, record] : records)
+        result.push_back (record);
+    return result;
+}
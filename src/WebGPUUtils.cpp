@@ -2,31 +2,83 @@
 
 #include "WebGPUUtils.h"
 
+#include <algorithm>
+#include <string>
 #include <thread>
 
 namespace
 {
-uint32_t getBytesPerPixel (WGPUTextureFormat format)
+using ChannelType = WebGPUTextureFormatInfo::ChannelType;
+
+const WebGPUTextureFormatInfo formatTable[] {
+    { WGPUTextureFormat_R8Unorm, 1, 1, 1, ChannelType::Unorm8, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG8Unorm, 2, 1, 1, ChannelType::Unorm8, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA8Unorm, 4, 1, 1, ChannelType::Unorm8, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_RGBA8UnormSrgb, 4, 1, 1, ChannelType::Unorm8, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BGRA8Unorm, 4, 1, 1, ChannelType::Unorm8, 4, { 2, 1, 0, 3 } },
+    { WGPUTextureFormat_BGRA8UnormSrgb, 4, 1, 1, ChannelType::Unorm8, 4, { 2, 1, 0, 3 } },
+    { WGPUTextureFormat_R16Float, 2, 1, 1, ChannelType::Float16, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG16Float, 4, 1, 1, ChannelType::Float16, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA16Float, 8, 1, 1, ChannelType::Float16, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_R32Float, 4, 1, 1, ChannelType::Float32, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG32Float, 8, 1, 1, ChannelType::Float32, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA32Float, 16, 1, 1, ChannelType::Float32, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_R8Uint, 1, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_R8Sint, 1, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG8Uint, 2, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RG8Sint, 2, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA8Uint, 4, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_RGBA8Sint, 4, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_R16Uint, 2, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_R16Sint, 2, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG16Uint, 4, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RG16Sint, 4, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA16Uint, 8, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_RGBA16Sint, 8, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_R32Uint, 4, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_R32Sint, 4, 1, 1, ChannelType::Integer, 1, { 0, -1, -1, -1 } },
+    { WGPUTextureFormat_RG32Uint, 8, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RG32Sint, 8, 1, 1, ChannelType::Integer, 2, { 0, 1, -1, -1 } },
+    { WGPUTextureFormat_RGBA32Uint, 16, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_RGBA32Sint, 16, 1, 1, ChannelType::Integer, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC1RGBAUnorm, 8, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC1RGBAUnormSrgb, 8, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC3RGBAUnorm, 16, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC3RGBAUnormSrgb, 16, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC7RGBAUnorm, 16, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+    { WGPUTextureFormat_BC7RGBAUnormSrgb, 16, 4, 4, ChannelType::Compressed, 4, { 0, 1, 2, 3 } },
+};
+
+std::string toString (WGPUStringView view)
+{
+    if (view.data == nullptr)
+        return {};
+    if (view.length == WGPU_STRLEN)
+        return view.data;
+    return std::string (view.data, view.length);
+}
+
+uint64_t getTextureSize (const WGPUTextureDescriptor& desc, bool& isEstimate)
 {
-    switch (format)
+    // Formats missing from the table are estimated at 4 bytes per texel, which is marked in the tracker
+    const WebGPUTextureFormatInfo fallback { desc.format, 4, 1, 1, ChannelType::Unorm8, 4, { 0, 1, 2, 3 } };
+    const WebGPUTextureFormatInfo* info = WebGPUTextureFormatInfo::find (desc.format);
+    isEstimate = info == nullptr;
+    if (info == nullptr)
+        info = &fallback;
+
+    uint64_t total = 0;
+    uint32_t width = desc.size.width;
+    uint32_t height = desc.size.height;
+    for (uint32_t level = 0; level < std::max (desc.mipLevelCount, 1u); ++level)
     {
-        case WGPUTextureFormat_RGBA8Unorm:
-        case WGPUTextureFormat_RGBA8UnormSrgb:
-        case WGPUTextureFormat_BGRA8Unorm:
-        case WGPUTextureFormat_BGRA8UnormSrgb:
-            return 4;
-        case WGPUTextureFormat_RG8Unorm:
-            return 2;
-        case WGPUTextureFormat_R8Unorm:
-            return 1;
-        case WGPUTextureFormat_RGBA16Float:
-            return 8;
-        case WGPUTextureFormat_RGBA32Float:
-            return 16;
-        default:
-            // Default to 4 bytes for common RGBA formats
-            return 4;
+        const uint64_t blocksWide = (width + info->blockWidth - 1) / info->blockWidth;
+        const uint64_t blocksHigh = (height + info->blockHeight - 1) / info->blockHeight;
+        total += blocksWide * blocksHigh * info->bytesPerBlock;
+        width = std::max (width / 2, 1u);
+        height = std::max (height / 2, 1u);
     }
+    return total * std::max (desc.size.depthOrArrayLayers, 1u) * std::max (desc.sampleCount, 1u);
 }
 } // namespace
 
@@ -41,7 +93,11 @@ bool WebGPUContext::init()
         return false;
 
     queue = device->getQueue();
-    return queue;
+    if (! queue)
+        return false;
+
+    memory.addEvictor ([this] (uint64_t bytesWanted) { return evictRecycledBuffers (bytesWanted); });
+    return true;
 }
 
 wgpu::raii::ShaderModule WebGPUContext::loadWgslShader (const char* source, const char* name)
@@ -57,26 +113,139 @@ wgpu::raii::ShaderModule WebGPUContext::loadWgslShader (const char* source, cons
     return wgpu::raii::ShaderModule (wgpuDeviceCreateShaderModule (*device, &shaderDesc));
 }
 
+WebGPUBuffer WebGPUContext::createBuffer (const WGPUBufferDescriptor& desc)
+{
+    const bool mappable = (desc.usage & (wgpu::BufferUsage::MapRead | wgpu::BufferUsage::MapWrite)) != 0;
+    WebGPUBuffer result;
+    result.allocation = memory.allocate (
+        mappable ? WebGPUMemoryTracker::Category::Staging : WebGPUMemoryTracker::Category::Buffer,
+        desc.size,
+        desc.usage,
+        toString (desc.label));
+    if (! result.allocation)
+        return {};
+
+    result.buffer = device->createBuffer (desc);
+    if (! result.buffer)
+        return {};
+    result.size = desc.size;
+    result.usage = desc.usage;
+    return result;
+}
+
+WebGPUBuffer WebGPUContext::acquireBuffer (const WGPUBufferDescriptor& desc)
+{
+    std::vector<WebGPUBuffer> stale; // Declared before the lock, so that they're released after unlocking
+    {
+        std::lock_guard<std::mutex> lock (recycledBuffersMutex);
+        WebGPUBuffer result;
+        for (auto it = recycledBuffers.begin(); it != recycledBuffers.end();)
+        {
+            if (it->usage != desc.usage || (it->size == desc.size && result.buffer))
+            {
+                ++it;
+                continue;
+            }
+
+            // A buffer of the same usage but another size is left over from before a resize,
+            // and would otherwise be held until evicted
+            if (it->size == desc.size)
+                result = std::move (*it);
+            else
+                stale.push_back (std::move (*it));
+            it = recycledBuffers.erase (it);
+        }
+        if (result.buffer)
+            return result;
+    }
+    // Released before creating the new buffer, so that they don't count against the budget
+    stale.clear();
+
+    // Not holding the lock, as creating a buffer may evict recycled ones
+    return createBuffer (desc);
+}
+
+void WebGPUContext::recycleBuffer (WebGPUBuffer buffer)
+{
+    if (! buffer.buffer)
+        return;
+
+    WebGPUBuffer dropped; // Declared before the lock, so that it's released after unlocking
+    std::lock_guard<std::mutex> lock (recycledBuffersMutex);
+    if (recycledBuffers.size() >= maxRecycledBuffers)
+    {
+        dropped = std::move (recycledBuffers.front());
+        recycledBuffers.erase (recycledBuffers.begin());
+    }
+    recycledBuffers.push_back (std::move (buffer));
+}
+
+uint64_t WebGPUContext::evictRecycledBuffers (uint64_t bytesWanted)
+{
+    std::vector<WebGPUBuffer> evicted;
+    uint64_t freed = 0;
+    {
+        std::lock_guard<std::mutex> lock (recycledBuffersMutex);
+        while (freed < bytesWanted && ! recycledBuffers.empty())
+        {
+            freed += recycledBuffers.front().size;
+            evicted.push_back (std::move (recycledBuffers.front()));
+            recycledBuffers.erase (recycledBuffers.begin());
+        }
+    }
+    // The evicted buffers are released here, after the lock
+    return freed;
+}
+
 bool WebGPUTexture::init (WebGPUContext& context, const WGPUTextureDescriptor& desc)
 {
-    descriptor = desc;
+    // Release the old texture first, so that its memory doesn't count against the budget for the new one.
+    // On failure the texture is left empty rather than holding an old texture that doesn't match the descriptor.
+    view = wgpu::raii::TextureView();
+    texture = wgpu::raii::Texture();
+    allocation = WebGPUMemoryTracker::Allocation();
+
+    bool sizeIsEstimate = false;
+    const uint64_t size = getTextureSize (desc, sizeIsEstimate);
+    auto newAllocation = context.memory.allocate (WebGPUMemoryTracker::Category::Texture, size, desc.usage, toString (desc.label), sizeIsEstimate);
+    if (! newAllocation)
+        return false;
     texture = context.device->createTexture (desc);
     if (! texture)
         return false;
     view = texture->createView();
-    return view;
+    if (! view)
+        return false;
+
+    allocation = std::move (newAllocation);
+    descriptor = desc;
+    return true;
+}
+
+const WebGPUTextureFormatInfo* WebGPUTextureFormatInfo::find (WGPUTextureFormat format)
+{
+    for (const WebGPUTextureFormatInfo& info : formatTable)
+        if (info.format == format)
+            return &info;
+    return nullptr;
 }
 
-wgpu::raii::Buffer WebGPUTexture::read (WebGPUContext& context)
+WebGPUBuffer WebGPUTexture::read (WebGPUContext& context)
 {
     const auto rowSize = (uint32_t) bytesPerRow();
-    const uint32_t bufferSize = rowSize * descriptor.size.height;
+    if (! texture || rowSize == 0)
+        return {};
+    const uint32_t bufferSize = rowSize * rowCount();
 
-    wgpu::raii::Buffer readbackBuffer = context.device->createBuffer (WGPUBufferDescriptor {
+    WebGPUBuffer readback = context.acquireBuffer (WGPUBufferDescriptor {
+        .label = wgpu::StringView ("Texture readback"),
         .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead,
         .size = bufferSize,
         .mappedAtCreation = false,
     });
+    if (! readback.buffer)
+        return {};
+    wgpu::raii::Buffer& readbackBuffer = readback.buffer;
 
     {
         wgpu::raii::CommandEncoder encoder = context.device->createCommandEncoder();
@@ -91,7 +260,7 @@ wgpu::raii::Buffer WebGPUTexture::read (WebGPUContext& context)
                 .layout = {
                     .offset = 0,
                     .bytesPerRow = rowSize,
-                    .rowsPerImage = descriptor.size.height,
+                    .rowsPerImage = rowCount(),
                 },
                 .buffer = *readbackBuffer,
             },
@@ -121,16 +290,31 @@ wgpu::raii::Buffer WebGPUTexture::read (WebGPUContext& context)
         std::this_thread::sleep_for (std::chrono::milliseconds (1));
     }
 
-    return readbackBuffer;
+    return readback;
 }
 
 int WebGPUTexture::bytesPerRow() const
 {
-    const uint32_t unalignedBytesPerRow = descriptor.size.width * getBytesPerPixel (descriptor.format);
+    const WebGPUTextureFormatInfo* info = WebGPUTextureFormatInfo::find (descriptor.format);
+    if (info == nullptr)
+        return 0;
+
+    const uint32_t blocksPerRow = (descriptor.size.width + info->blockWidth - 1) / info->blockWidth;
+    const uint32_t unalignedBytesPerRow = blocksPerRow * info->bytesPerBlock;
     const uint32_t alignment = 256;
     return ((unalignedBytesPerRow + alignment - 1) / alignment) * alignment;
 }
 
+uint32_t WebGPUTexture::rowCount() const
+{
+    const WebGPUTextureFormatInfo* info = WebGPUTextureFormatInfo::find (descriptor.format);
+    if (info == nullptr)
+        return 0;
+
+    // For compressed formats, a row is a row of blocks
+    return (descriptor.size.height + info->blockHeight - 1) / info->blockHeight;
+}
+
 const char* WebGPUPassThroughFragmentShader::wgslSource = R"(
     @fragment
     fn fragIdent(@location(0) color: vec4<f32>) -> @location(0) vec4<f32> {